@@ -9,6 +9,27 @@ SOURCES=$(cat <<EOF
 src/core.c
 src/main.c
 src/fluid.c
+src/ensemble.c
+src/particles.c
+src/publish.c
+EOF
+)
+
+# Example reader of the frames published with --publish
+READER_SOURCES=$(cat <<EOF
+src/core.c
+src/reader.c
+src/publish.c
+EOF
+)
+
+# Headless benchmark, links no raylib and opens no window
+BENCH_SOURCES=$(cat <<EOF
+src/core.c
+src/bench.c
+src/fluid.c
+src/ensemble.c
+src/particles.c
 EOF
 )
 
@@ -16,6 +37,9 @@ LINUX="linux"
 MACOS="macos"
 WINDOWS="windows"
 WEB="web"
+BENCH="bench"
+BENCH_WEB="bench-web"
+READER="reader"
 
 # FUNCTIONS ###################################################################
 
@@ -25,6 +49,9 @@ help() {
     echo "  $0 $MACOS"
     echo "  $0 $WINDOWS"
     echo "  $0 $WEB"
+    echo "  $0 $BENCH [grid count] [step count] [thread count]"
+    echo "  $0 $BENCH_WEB [grid count] [step count] [thread count]"
+    echo "  $0 $READER [shared memory name]"
     exit 1
 }
 
@@ -47,7 +74,7 @@ shift
 
 # Determine if supplied platform is valid and ensure build directory exists
 case $PLATFORM in
-    $LINUX | $MACOS | $WINDOWS | $WEB)
+    $LINUX | $MACOS | $WINDOWS | $WEB | $BENCH | $BENCH_WEB | $READER)
         mkdir -p $BUILD_DIR
 
         TARGET_DIR="$BUILD_DIR/$PLATFORM"
@@ -83,7 +110,7 @@ case $PLATFORM in
     $WINDOWS)
         # https://github.com/raysan5/raylib/wiki/Working-on-Windows
         gcc $SOURCES -DPLATFORM_WINDOWS \
-            -lraylib -lgdi32 -lwinmm \
+            -lraylib -lgdi32 -lwinmm -lpthread \
             -Wall \
             "$@" \
             -o $TARGET_DIR/game.exe
@@ -95,13 +122,21 @@ case $PLATFORM in
 
         # https://github.com/raysan5/raylib/wiki/Working-for-Web-(HTML5)
         # Also define WEB so code can run specific web logic
+        # Kernels are compiled with SIMD128 and the solver runs on a pthread
+        # Web Worker, which needs a cross-origin isolated page (emrun is).
+        # PTHREAD_POOL_SIZE is the number of threads main.c creates, one for
+        # the simulation and two for the tracers.
+        # NOTE: Every object in a pthread module must be built with -pthread,
+        # the stock libraylib.web.a is not and fails to link. Rebuild it with
+        # make -C $HOME/raylib/src PLATFORM=PLATFORM_WEB CUSTOM_CFLAGS=-pthread -B
         emcc -o $TARGET_DIR/index.html \
             $SOURCES \
-            -Os -Wall \
+            -O2 -msimd128 -pthread -Wall \
             $HOME/raylib/src/web/libraylib.web.a \
             -I. -I$HOME/raylib/src -L. -L$HOME/raylib/src/web \
             -s USE_GLFW=3 \
             -s ASYNCIFY \
+            -s PTHREAD_POOL_SIZE=3 \
             --shell-file $HOME/raylib/src/minshell.html \
             --preload-file src/data \
             -s TOTAL_STACK=64MB \
@@ -109,6 +144,48 @@ case $PLATFORM in
             -DPLATFORM_WEB \
             "$@"
         ;;
+    $BENCH)
+        # Arguments are passed to the benchmark rather than the compiler.
+        # Contraction is disabled so scalar and ensemble results compare exactly
+        cc $BENCH_SOURCES \
+            -I$HOME/raylib/src \
+            -lm -lpthread \
+            -O2 -ffp-contract=off -Wall \
+            -o $TARGET_DIR/bench
+        ;;
+    $BENCH_WEB)
+        if [ -z "$EMSDK" ]; then
+            help_web
+        fi
+
+        # Same benchmark as a Node program so SIMD128 and pthread speedups can
+        # be checked without a browser. Workers are created up front as Node
+        # can not start them while the main thread is blocked. Memory is fixed
+        # as growth is slow with pthreads, sized for bench.c's 512MB arena
+        emcc $BENCH_SOURCES \
+            -I$HOME/raylib/src \
+            -O2 -msimd128 -pthread -ffp-contract=off -Wall \
+            -s ENVIRONMENT=node,worker \
+            -s PTHREAD_POOL_SIZE="require('os').cpus().length" \
+            -s INITIAL_MEMORY=640MB \
+            -s EXIT_RUNTIME=1 \
+            -DPLATFORM_WEB \
+            -o $TARGET_DIR/bench.js
+        ;;
+    $READER)
+        # Arguments are passed to the reader rather than the compiler.
+        # shm_open lives in librt on Linux and in libc elsewhere, core.c's
+        # thread pool needs libpthread on older glibc
+        READER_LIBS="-lm -lpthread"
+        if [ "$(uname)" = "Linux" ]; then
+            READER_LIBS="$READER_LIBS -lrt"
+        fi
+        cc $READER_SOURCES \
+            -I$HOME/raylib/src \
+            $READER_LIBS \
+            -O2 -Wall \
+            -o $TARGET_DIR/reader
+        ;;
 esac
 
 # Exit the script if the last command, compilation, was unsuccessful
@@ -132,4 +209,13 @@ case $PLATFORM in
     $WEB)
         emrun $TARGET_DIR/index.html
         ;;
+    $BENCH)
+        $TARGET_DIR/bench "$@"
+        ;;
+    $BENCH_WEB)
+        node $TARGET_DIR/bench.js "$@"
+        ;;
+    $READER)
+        $TARGET_DIR/reader "$@"
+        ;;
 esac
@@ -0,0 +1,236 @@
+// Headless benchmark, does not open a window or call into raylib.
+// Usage: bench [grid count] [step count] [thread count]
+#include <stdlib.h>
+#include <time.h>
+
+#include "core.h"
+#include "constants.h"
+#include "fluid.h"
+#include "ensemble.h"
+#include "particles.h"
+
+// Bounds on the error of half against f32 storage, relative to the largest
+// magnitude the field reaches
+static const f64 HALF_MAX_ERROR = 0.01;
+static const f64 HALF_RMS_ERROR = 0.001;
+
+static f64 BenchTime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+// Deterministic but different starting state and parameters for every grid
+static void BenchSeedGrid(FluidGrid* fluid, RNG* rng, f32* visc, f32* diff) {
+    FluidGridReset(fluid);
+
+    for (i32 k = 0; k < 8; k++) {
+        i32 x = 1 + Random_u32(rng) % FLUID_SIZE;
+        i32 y = 1 + Random_u32(rng) % FLUID_SIZE;
+        i32 grid_index = FluidIX(x, y);
+        fluid->dens_prev[grid_index] = 20.0f;
+        fluid->u_prev[grid_index] = RandomNormBetween(rng, -50.0f, 50.0f);
+        fluid->v_prev[grid_index] = RandomNormBetween(rng, -50.0f, 50.0f);
+    }
+
+    for (i32 k = 0; k < 32; k++) {
+        i32 x = 1 + Random_u32(rng) % FLUID_SIZE;
+        i32 y = 1 + Random_u32(rng) % FLUID_SIZE;
+        fluid->solid[FluidIX(x, y)] = true;
+    }
+
+    *visc = Random_f32(rng) * 0.0001f;
+    *diff = Random_f32(rng) * 0.0001f;
+}
+
+static f64 BenchSquaredError(f32* a, f32* b) {
+    f64 error = 0.0;
+    for (i32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        f64 d = (f64)a[i] - (f64)b[i];
+        error += d * d;
+    }
+    return error;
+}
+
+static f32 BenchMaxAbs(f32* a) {
+    f32 value = 0.0f;
+    for (i32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        value = Max(value, abs_f32(a[i]));
+    }
+    return value;
+}
+
+static f32 BenchMaxError(f32* a, f32* b) {
+    f32 error = 0.0f;
+    for (i32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        error = Max(error, abs_f32(a[i] - b[i]));
+    }
+    return error;
+}
+
+// Positive integer argument or the fallback when absent, 0 if invalid
+static u32 BenchArg(int argc, char** argv, int index, u32 fallback) {
+    if (argc <= index) { return fallback; }
+    i32 value = atoi(argv[index]);
+    return (value > 0) ? (u32)value : 0;
+}
+
+int main(int argc, char** argv) {
+    u32 grid_count = BenchArg(argc, argv, 1, 256);
+    u32 step_count = BenchArg(argc, argv, 2, 100);
+    u32 thread_count = BenchArg(argc, argv, 3, OS_CoreCount());
+    if (grid_count == 0 || step_count == 0 || thread_count == 0) {
+        printf("Usage: %s [grid count] [step count] [thread count], all greater than 0\n", argv[0]);
+        return 1;
+    }
+
+#ifdef PLATFORM_WEB
+    // Only the pre-created pool of Web Workers can start while main is blocked
+    thread_count = Min(thread_count, OS_CoreCount());
+
+    // Emscripten's mmap allocates the whole reserve, fits INITIAL_MEMORY
+    Arena* arena = ArenaCreate(MiB(512), MiB(64));
+#else
+    Arena* arena = ArenaCreate(GiB(1), MiB(64));
+#endif
+
+    // The calling thread helps out in ThreadPoolWait so spawn one less
+    ThreadPool* pool = ThreadPoolCreate(arena, thread_count - 1);
+
+    FluidGrid** grids = ArenaPushArray(arena, FluidGrid*, grid_count);
+    FluidEnsemble* ensemble = FluidEnsembleCreate(arena, grid_count);
+
+    RNG rng = PCG32_INITIALIZER;
+    for (u32 i = 0; i < grid_count; i++) {
+        f32 visc, diff;
+        grids[i] = FluidGridCreate(arena);
+        BenchSeedGrid(grids[i], &rng, &visc, &diff);
+        FluidEnsembleLoad(ensemble, i, grids[i]);
+        FluidEnsembleSetParams(ensemble, i, visc, diff);
+    }
+
+    printf("%u grids of %ux%u, %u steps, %u threads\n",
+        grid_count, FLUID_SIZE, FLUID_SIZE, step_count, thread_count);
+
+    // Scalar reference, one grid at a time
+    f64 start = BenchTime();
+    for (u32 i = 0; i < grid_count; i++) {
+        FluidEnsembleBlock* block = &ensemble->blocks[i / FLUID_ENSEMBLE_LANES];
+        f32 visc = block->visc[i % FLUID_ENSEMBLE_LANES];
+        f32 diff = block->diff[i % FLUID_ENSEMBLE_LANES];
+        for (u32 s = 0; s < step_count; s++) {
+            FluidGridStep(grids[i], visc, diff);
+        }
+    }
+    f64 scalar_time = BenchTime() - start;
+
+    start = BenchTime();
+    for (u32 s = 0; s < step_count; s++) {
+        FluidEnsembleStep(ensemble, pool);
+    }
+    f64 ensemble_time = BenchTime() - start;
+
+    f32 error = 0.0f;
+    FluidGrid* check = FluidGridCreate(arena);
+    for (u32 i = 0; i < grid_count; i++) {
+        FluidEnsembleStore(ensemble, i, check);
+        error = Max(error, BenchMaxError(check->dens, grids[i]->dens));
+        error = Max(error, BenchMaxError(check->u, grids[i]->u));
+        error = Max(error, BenchMaxError(check->v, grids[i]->v));
+    }
+
+    f64 grid_steps = (f64)grid_count * step_count;
+    printf("scalar:   %10.1f grid-steps/s\n", grid_steps / scalar_time);
+    printf("ensemble: %10.1f grid-steps/s (%.2fx)\n", grid_steps / ensemble_time, scalar_time / ensemble_time);
+    printf("ensemble max abs error vs scalar: %g\n", error);
+
+    // Stepping as an ensemble must not change the results at all
+    b32 failed = error != 0.0f;
+    if (failed) { printf("[ FAILED ] Ensemble does not match scalar stepping\n"); }
+
+    // Tracers spread over the whole of the first grid
+    FluidParticles* particles = FluidParticlesCreate(arena, Million(1));
+    FluidParticlesEmit(particles, &rng, (Vector2){ FLUID_SIZE / 2.0f, FLUID_SIZE / 2.0f }, FLUID_SIZE / 2.0f, Million(1));
+
+    start = BenchTime();
+    for (u32 s = 0; s < step_count; s++) {
+        FluidParticlesStep(particles, grids[0], pool);
+    }
+    f64 particles_time = BenchTime() - start;
+
+    printf("particles: %9.1f M particle-steps/s\n", (f64)particles->count * step_count / particles_time * 1e-6);
+
+    // Half precision storage against f32 storage, both from the same start.
+    // Reseeding with a fresh RNG repeats the states and parameters from above
+    FluidGridHalf** halves = ArenaPushArray(arena, FluidGridHalf*, grid_count);
+    f32* viscs = ArenaPushArray(arena, f32, grid_count);
+    f32* diffs = ArenaPushArray(arena, f32, grid_count);
+    RNG half_rng = PCG32_INITIALIZER;
+    for (u32 i = 0; i < grid_count; i++) {
+        BenchSeedGrid(grids[i], &half_rng, &viscs[i], &diffs[i]);
+        halves[i] = FluidGridHalfCreate(arena);
+        FluidGridHalfPack(halves[i], grids[i]);
+    }
+
+    start = BenchTime();
+    for (u32 s = 0; s < step_count; s++) {
+        for (u32 i = 0; i < grid_count; i++) {
+            FluidGridStep(grids[i], viscs[i], diffs[i]);
+        }
+    }
+    f64 full_time = BenchTime() - start;
+
+    start = BenchTime();
+    for (u32 s = 0; s < step_count; s++) {
+        for (u32 i = 0; i < grid_count; i++) {
+            FluidGridHalfStep(halves[i], check, viscs[i], diffs[i]);
+        }
+    }
+    f64 half_time = BenchTime() - start;
+
+    // Errors relative to the largest magnitude each field reaches in f32
+    f32* fields_f32[3];
+    f32* fields_f16[3];
+    const char* field_names[3] = { "dens", "u", "v" };
+    f32 max_error[3] = { 0 };
+    f32 max_value[3] = { 0 };
+    f64 squared_error[3] = { 0 };
+    for (u32 i = 0; i < grid_count; i++) {
+        FluidGridHalfUnpack(halves[i], check);
+        fields_f32[0] = grids[i]->dens;
+        fields_f32[1] = grids[i]->u;
+        fields_f32[2] = grids[i]->v;
+        fields_f16[0] = check->dens;
+        fields_f16[1] = check->u;
+        fields_f16[2] = check->v;
+        for (u32 f = 0; f < 3; f++) {
+            max_error[f] = Max(max_error[f], BenchMaxError(fields_f32[f], fields_f16[f]));
+            max_value[f] = Max(max_value[f], BenchMaxAbs(fields_f32[f]));
+            squared_error[f] += BenchSquaredError(fields_f32[f], fields_f16[f]);
+        }
+    }
+
+    printf("f32 storage: %8.1f grid-steps/s, %llu bytes/grid\n",
+        grid_count * step_count / full_time, (unsigned long long)(FLUID_CELLS_BUFFERED * (6 * sizeof(f32) + sizeof(bool))));
+    printf("f16 storage: %8.1f grid-steps/s, %llu bytes/grid\n",
+        grid_count * step_count / half_time, (unsigned long long)(FLUID_CELLS_BUFFERED * (6 * sizeof(f16) + sizeof(bool))));
+    for (u32 f = 0; f < 3; f++) {
+        f64 rms = sqrt_f64(squared_error[f] / ((f64)grid_count * FLUID_CELLS_BUFFERED));
+        f64 scale = Max(max_value[f], 1e-30f);
+        printf("f16 %-4s error: max %g (%.3g%% of max |value|), rms %g (%.3g%%)\n",
+            field_names[f], max_error[f], 100.0 * max_error[f] / scale, rms, 100.0 * rms / scale);
+
+        // Half storage rounds to 11 significant bits every step, allow a few
+        // times the error seen with the default arguments
+        if (max_error[f] > HALF_MAX_ERROR * scale || rms > HALF_RMS_ERROR * scale) {
+            printf("[ FAILED ] f16 %s error above %g%% max or %g%% rms of max |value|\n",
+                field_names[f], 100.0 * HALF_MAX_ERROR, 100.0 * HALF_RMS_ERROR);
+            failed = true;
+        }
+    }
+
+    ThreadPoolDestroy(pool);
+    ArenaDestroy(arena);
+
+    return failed ? 1 : 0;
+}
@@ -1,5 +1,11 @@
 #include "core.h"
 
+// F16C is picked at run time so builds without -mf16c still get it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HALF_F16C
+#endif
+
 // OS /////////////////////////////////////////////////////////////////////////
 #ifdef _WIN32
 #include <windows.h>
@@ -10,6 +16,12 @@ static u32 OS_PageSize(void) {
     return sysinfo.dwPageSize;
 }
 
+u32 OS_CoreCount(void) {
+    SYSTEM_INFO sysinfo = { 0 };
+    GetSystemInfo(&sysinfo);
+    return Max(sysinfo.dwNumberOfProcessors, 1);
+}
+
 static void* OS_MemoryReserve(u64 size) {
     return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
 }
@@ -36,6 +48,11 @@ static u32 OS_PageSize(void) {
     return (u32)sysconf(_SC_PAGESIZE);
 }
 
+u32 OS_CoreCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (u32)count : 1;
+}
+
 static void* OS_MemoryReserve(u64 size) {
     void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     return (ptr == MAP_FAILED) ? NULL : ptr;
@@ -125,6 +142,205 @@ void ArenaClear(Arena* arena) {
     ArenaPopTo(arena, ARENA_BASE_POS);
 }
 
+// THREADS ////////////////////////////////////////////////////////////////////
+// NOTE: Expects the pool mutex to be held, returns with it held
+static void ThreadPoolRunTasks(ThreadPool* pool) {
+    while (pool->task_next < pool->task_count) {
+        u32 index = pool->task_next++;
+        pthread_mutex_unlock(&pool->mutex);
+        pool->task(pool->data, index);
+        pthread_mutex_lock(&pool->mutex);
+
+        pool->task_done++;
+        if (pool->task_done == pool->task_count) {
+            pthread_cond_broadcast(&pool->done_cond);
+        }
+    }
+}
+
+static void* ThreadPoolWorker(void* arg) {
+    ThreadPool* pool = arg;
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->quit) {
+        ThreadPoolRunTasks(pool);
+        pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+ThreadPool* ThreadPoolCreate(Arena* arena, u32 thread_count) {
+    ThreadPool* pool = ArenaPushStruct(arena, ThreadPool);
+    pool->threads = ArenaPushArray(arena, pthread_t, thread_count);
+    pool->thread_count = thread_count;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (u32 i = 0; i < thread_count; i++) {
+        b32 created = pthread_create(&pool->threads[i], NULL, ThreadPoolWorker, pool) == 0;
+        assert(created /*Unable to create worker thread*/);
+    }
+
+    return pool;
+}
+
+void ThreadPoolDestroy(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (u32 i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+void ThreadPoolDispatch(ThreadPool* pool, ThreadTask* task, void* data, u32 task_count) {
+    pthread_mutex_lock(&pool->mutex);
+    assert(pool->task_done == pool->task_count /*Previous dispatch still running*/);
+    pool->task = task;
+    pool->data = data;
+    pool->task_count = task_count;
+    pool->task_next = 0;
+    pool->task_done = 0;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void ThreadPoolWait(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    ThreadPoolRunTasks(pool);
+    while (pool->task_done < pool->task_count) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void ThreadPoolWaitWorkers(ThreadPool* pool) {
+    assert(pool->thread_count > 0 /*Nobody to run the tasks*/);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->task_done < pool->task_count) {
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void ThreadPoolFor(ThreadPool* pool, ThreadTask* task, void* data, u32 task_count) {
+    ThreadPoolDispatch(pool, task, data, task_count);
+    ThreadPoolWait(pool);
+}
+
+// MATH ///////////////////////////////////////////////////////////////////////
+// Based on https://gist.github.com/rygorous/2156668 (public domain)
+f16 HalfFromF32(f32 value) {
+    static const u32 F32_INFINITY = 255 << 23;
+    static const u32 F16_OVERFLOW = (127 + 16) << 23;
+    static const u32 DENORM_MAGIC = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32 sign = bits & 0x80000000;
+    bits ^= sign;
+
+    u16 out;
+    if (bits >= F16_OVERFLOW) {
+        // Infinity stays infinity, NaN becomes quiet NaN
+        out = (bits > F32_INFINITY) ? 0x7e00 : 0x7c00;
+    } else if (bits < (113 << 23)) {
+        // Subnormal, let the float adder do the rounding
+        f32 magic;
+        memcpy(&magic, &DENORM_MAGIC, sizeof(magic));
+        f32 f;
+        memcpy(&f, &bits, sizeof(f));
+        f += magic;
+        memcpy(&bits, &f, sizeof(bits));
+        out = bits - DENORM_MAGIC;
+    } else {
+        u32 mant_odd = (bits >> 13) & 1;
+        bits += ((u32)(15 - 127) << 23) + 0xfff;
+        bits += mant_odd;
+        out = bits >> 13;
+    }
+
+    return out | (sign >> 16);
+}
+
+f32 HalfToF32(f16 value) {
+    static const u32 SHIFTED_EXP = 0x7c00 << 13;
+    static const u32 MAGIC = 113 << 23;
+
+    u32 bits = (value & 0x7fff) << 13;
+    u32 exp = SHIFTED_EXP & bits;
+    bits += (127 - 15) << 23;
+
+    if (exp == SHIFTED_EXP) {
+        // Infinity or NaN
+        bits += (128 - 16) << 23;
+    } else if (exp == 0) {
+        // Zero or subnormal, renormalise
+        bits += 1 << 23;
+        f32 f, magic;
+        memcpy(&f, &bits, sizeof(f));
+        memcpy(&magic, &MAGIC, sizeof(magic));
+        f -= magic;
+        memcpy(&bits, &f, sizeof(bits));
+    }
+
+    bits |= (u32)(value & 0x8000) << 16;
+    f32 out;
+    memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+#ifdef HALF_F16C
+// Compiled for F16C whatever the build flags, only called once the CPU is
+// known to have it. Return how many elements were converted
+__attribute__((target("avx,f16c")))
+static u64 HalfFromF32ArrayF16C(f16* dst, f32* src, u64 count) {
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), h);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static u64 HalfToF32ArrayF16C(f32* dst, f16* src, u64 count) {
+    u64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128((__m128i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+#endif
+
+void HalfFromF32Array(f16* dst, f32* src, u64 count) {
+    u64 i = 0;
+#ifdef HALF_F16C
+    if (__builtin_cpu_supports("f16c")) { i = HalfFromF32ArrayF16C(dst, src, count); }
+#endif
+    for (; i < count; i++) {
+        dst[i] = HalfFromF32(src[i]);
+    }
+}
+
+void HalfToF32Array(f32* dst, f16* src, u64 count) {
+    u64 i = 0;
+#ifdef HALF_F16C
+    if (__builtin_cpu_supports("f16c")) { i = HalfToF32ArrayF16C(dst, src, count); }
+#endif
+    for (; i < count; i++) {
+        dst[i] = HalfToF32(src[i]);
+    }
+}
+
 // RANDOM /////////////////////////////////////////////////////////////////////
 void RandomSetSeed(RNG* rng, u64 initstate, u64 initseq) {
     rng->state = 0;
@@ -4,6 +4,7 @@
 // EXTERNAL INCLUDES //////////////////////////////////////////////////////////
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -58,6 +59,7 @@ typedef i64      b64;
 // Floating point types
 typedef float    f32;
 typedef double   f64;
+typedef u16      f16; // IEEE 754 half, storage only, do maths in f32
 
 // Constants
 static const u64 MAX_U64 = 0XFfffffffffffffffull;
@@ -164,6 +166,35 @@ void ArenaClear(Arena* arena);
 #define ArenaPushArray(arena, T, n) (T*)ArenaPush((arena), sizeof(T) * (n), true)
 #define ArenaPushArrayNonZero(arena, T, n) (T*)ArenaPush((arena), sizeof(T) * (n), false)
 
+// THREADS ////////////////////////////////////////////////////////////////////
+// Fixed pool of worker threads running indexed tasks. Dispatch hands out the
+// indices [0, task_count) to the workers, Wait blocks until all are finished
+// and has the calling thread help with the remaining indices. WaitWorkers
+// only blocks, for callers that must stay responsive such as a render loop.
+typedef void ThreadTask(void* data, u32 index);
+
+typedef struct {
+    pthread_t* threads;
+    u32 thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    ThreadTask* task;
+    void* data;
+    u32 task_count;
+    u32 task_next;
+    u32 task_done;
+    b32 quit;
+} ThreadPool;
+
+u32 OS_CoreCount(void);
+ThreadPool* ThreadPoolCreate(Arena* arena, u32 thread_count);
+void ThreadPoolDestroy(ThreadPool* pool);
+void ThreadPoolDispatch(ThreadPool* pool, ThreadTask* task, void* data, u32 task_count);
+void ThreadPoolWait(ThreadPool* pool);
+void ThreadPoolWaitWorkers(ThreadPool* pool);
+void ThreadPoolFor(ThreadPool* pool, ThreadTask* task, void* data, u32 task_count);
+
 // MATH ///////////////////////////////////////////////////////////////////////
 typedef struct {
     i32 x;
@@ -198,6 +229,13 @@ typedef struct {
 #define cos_f64(v)    cos(v)
 #define tan_f64(v)    tan(v)
 
+// Half precision conversion, rounds to nearest even. The array versions use
+// F16C on x86 CPUs that have it, checked at run time
+f16 HalfFromF32(f32 value);
+f32 HalfToF32(f16 value);
+void HalfFromF32Array(f16* dst, f32* src, u64 count);
+void HalfToF32Array(f32* dst, f16* src, u64 count);
+
 // RANDOM /////////////////////////////////////////////////////////////////////
 // Based on the PCG random number generator (https://www.pcg-random.org/)
 // Licensed under Apache License 2.0 (NO WARRANTY, etc. see website)
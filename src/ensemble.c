@@ -0,0 +1,330 @@
+// Lane-interleaved version of the solver in fluid.c. Every kernel performs the
+// same operations in the same order as its scalar counterpart so a grid stepped
+// in an ensemble matches the same grid stepped alone with FluidGridStep.
+#include "ensemble.h"
+
+#define SWAP(x0, x) {f32* tmp = x0; x0 = x; x = tmp;}
+#define LANES FLUID_ENSEMBLE_LANES
+
+static const u32 ENSEMBLE_FIELD_SIZE = FLUID_CELLS_BUFFERED * LANES;
+
+static inline i32 EnsembleIX(i32 x, i32 y) {
+    return (y * FLUID_SIZE_BUFFERED + x) * LANES;
+}
+
+FluidEnsemble* FluidEnsembleCreate(Arena* arena, u32 count) {
+    FluidEnsemble* ensemble = ArenaPushStruct(arena, FluidEnsemble);
+    ensemble->count = count;
+    ensemble->block_count = (count + LANES - 1) / LANES;
+    ensemble->blocks = ArenaPushArray(arena, FluidEnsembleBlock, ensemble->block_count);
+
+    for (u32 i = 0; i < ensemble->block_count; i++) {
+        FluidEnsembleBlock* block = &ensemble->blocks[i];
+        block->u = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->v = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->u_prev = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->v_prev = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->dens = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->dens_prev = ArenaPushArray(arena, f32, ENSEMBLE_FIELD_SIZE);
+        block->solid = ArenaPushArray(arena, bool, ENSEMBLE_FIELD_SIZE);
+        block->solid_cells = ArenaPushArray(arena, u32, FLUID_CELLS);
+    }
+
+    return ensemble;
+}
+
+void FluidEnsembleSetParams(FluidEnsemble* ensemble, u32 index, f32 visc, f32 diff) {
+    assert(index < ensemble->count);
+    FluidEnsembleBlock* block = &ensemble->blocks[index / LANES];
+    block->visc[index % LANES] = visc;
+    block->diff[index % LANES] = diff;
+}
+
+void FluidEnsembleLoad(FluidEnsemble* ensemble, u32 index, FluidGrid* fluid) {
+    assert(index < ensemble->count);
+    FluidEnsembleBlock* block = &ensemble->blocks[index / LANES];
+    u32 lane = index % LANES;
+    for (u32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        u32 e = i * LANES + lane;
+        block->u[e] = fluid->u[i];
+        block->v[e] = fluid->v[i];
+        block->u_prev[e] = fluid->u_prev[i];
+        block->v_prev[e] = fluid->v_prev[i];
+        block->dens[e] = fluid->dens[i];
+        block->dens_prev[e] = fluid->dens_prev[i];
+        block->solid[e] = fluid->solid[i];
+    }
+}
+
+void FluidEnsembleStore(FluidEnsemble* ensemble, u32 index, FluidGrid* fluid) {
+    assert(index < ensemble->count);
+    FluidEnsembleBlock* block = &ensemble->blocks[index / LANES];
+    u32 lane = index % LANES;
+    for (u32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        u32 e = i * LANES + lane;
+        fluid->u[i] = block->u[e];
+        fluid->v[i] = block->v[e];
+        fluid->u_prev[i] = block->u_prev[e];
+        fluid->v_prev[i] = block->v_prev[e];
+        fluid->dens[i] = block->dens[e];
+        fluid->dens_prev[i] = block->dens_prev[e];
+        fluid->solid[i] = block->solid[e];
+    }
+}
+
+// Collect the interior cells that are solid in at least one lane so that
+// EnsembleSetBound only has to visit those
+static void EnsembleFindSolidCells(FluidEnsembleBlock* block) {
+    block->solid_cell_count = 0;
+    for (i32 i = 1; i <= FLUID_SIZE; i++) {
+        for (i32 j = 1; j <= FLUID_SIZE; j++) {
+            i32 c = EnsembleIX(j, i);
+            bool any = false;
+            for (u32 l = 0; l < LANES; l++) { any |= block->solid[c + l]; }
+            if (any) { block->solid_cells[block->solid_cell_count++] = c; }
+        }
+    }
+}
+
+static void EnsembleAddSource(f32* restrict x, f32* restrict s) {
+    for (u32 i = 0; i < ENSEMBLE_FIELD_SIZE; i++) {
+        x[i] += s[i] * FIXED_DT;
+    }
+}
+
+static void EnsembleSetBound(i32 b, f32* x, FluidEnsembleBlock* block) {
+    // Border edges
+    for (i32 i = 1; i <= FLUID_SIZE; i++) {
+        for (u32 l = 0; l < LANES; l++) {
+            x[EnsembleIX(0, i) + l] = (b == 1) ? -x[EnsembleIX(1, i) + l] : x[EnsembleIX(1, i) + l];
+            x[EnsembleIX(FLUID_SIZE + 1, i) + l] = (b == 1) ? -x[EnsembleIX(FLUID_SIZE, i) + l] : x[EnsembleIX(FLUID_SIZE, i) + l];
+            x[EnsembleIX(i, 0) + l] = (b == 2) ? -x[EnsembleIX(i, 1) + l] : x[EnsembleIX(i, 1) + l];
+            x[EnsembleIX(i, FLUID_SIZE + 1) + l] = (b == 2) ? -x[EnsembleIX(i, FLUID_SIZE) + l] : x[EnsembleIX(i, FLUID_SIZE) + l];
+        }
+    }
+
+    // Border corners
+    for (u32 l = 0; l < LANES; l++) {
+        x[EnsembleIX(0, 0) + l] = 0.5f * (x[EnsembleIX(1, 0) + l] + x[EnsembleIX(0, 1) + l]);
+        x[EnsembleIX(0, FLUID_SIZE + 1) + l] = 0.5f * (x[EnsembleIX(1, FLUID_SIZE + 1) + l] + x[EnsembleIX(0, FLUID_SIZE) + l]);
+        x[EnsembleIX(FLUID_SIZE + 1, 0) + l] = 0.5f * (x[EnsembleIX(FLUID_SIZE, 0) + l] + x[EnsembleIX(FLUID_SIZE + 1, 1) + l]);
+        x[EnsembleIX(FLUID_SIZE + 1, FLUID_SIZE + 1) + l] = 0.5f * (x[EnsembleIX(FLUID_SIZE, FLUID_SIZE + 1) + l] + x[EnsembleIX(FLUID_SIZE + 1, FLUID_SIZE) + l]);
+    }
+
+    // Grid collisions
+    // NOTE: Solid cells only read from non-solid neighbours so visiting them in
+    // list order gives the same result as the full scan in FluidSetBound
+    const i32 right = EnsembleIX(1, 0);
+    const i32 down = EnsembleIX(0, 1);
+    for (u32 n = 0; n < block->solid_cell_count; n++) {
+        i32 c = block->solid_cells[n];
+        bool* solid = block->solid + c;
+        f32* xc = x + c;
+
+        for (i32 l = 0; l < LANES; l++) {
+            if (!solid[l]) continue;
+
+            f32 sum = 0.0f;
+            i32 count = 0;
+
+            if (!solid[l + right]) {
+                sum += (b == 1) ? -xc[l + right] : xc[l + right];
+                count++;
+            }
+
+            if (!solid[l - right]) {
+                sum += (b == 1) ? -xc[l - right] : xc[l - right];
+                count++;
+            }
+
+            if (!solid[l + down]) {
+                sum += (b == 2) ? -xc[l + down] : xc[l + down];
+                count++;
+            }
+
+            if (!solid[l - down]) {
+                sum += (b == 2) ? -xc[l - down] : xc[l - down];
+                count++;
+            }
+
+            xc[l] = (count > 0) ? sum / count : 0.0f;
+        }
+    }
+}
+
+// One Gauss-Seidel update of a cell in every lane. The neighbours are other
+// cells so none of the pointers overlap, restrict lets the lane loop vectorise
+static inline void EnsembleDiffuseCell(
+    f32* restrict x, const f32* restrict x0,
+    const f32* restrict left, const f32* restrict right,
+    const f32* restrict up, const f32* restrict down,
+    const f32* restrict a, const f32* restrict denom
+) {
+    for (u32 l = 0; l < LANES; l++) {
+        x[l] = (x0[l] + a[l] * (left[l] + right[l] + up[l] + down[l])) / denom[l];
+    }
+}
+
+static void EnsembleDiffuse(i32 b, f32* restrict x, f32* restrict x0, f32* diff, FluidEnsembleBlock* block) {
+    f32 a[LANES];
+    f32 denom[LANES];
+    for (u32 l = 0; l < LANES; l++) {
+        a[l] = FIXED_DT * diff[l] * FLUID_CELLS;
+        denom[l] = 1 + 4 * a[l];
+    }
+
+    for (i32 k = 0; k < 20; k++) {
+        for (i32 i = 1; i <= FLUID_SIZE; i++) {
+            for (i32 j = 1; j <= FLUID_SIZE; j++) {
+                EnsembleDiffuseCell(
+                    x + EnsembleIX(i, j), x0 + EnsembleIX(i, j),
+                    x + EnsembleIX(i - 1, j), x + EnsembleIX(i + 1, j),
+                    x + EnsembleIX(i, j - 1), x + EnsembleIX(i, j + 1),
+                    a, denom
+                );
+            }
+        }
+        EnsembleSetBound(b, x, block);
+    }
+}
+
+static void EnsembleAdvect(i32 b, f32* d, f32* d0, f32* u, f32* v, FluidEnsembleBlock* block) {
+    f32 dt0 = FIXED_DT * FLUID_SIZE;
+    for (i32 i = 1; i <= FLUID_SIZE; i++) {
+        for (i32 j = 1; j <= FLUID_SIZE; j++) {
+            i32 c = EnsembleIX(i, j);
+            for (u32 l = 0; l < LANES; l++) {
+                f32 x = i - dt0 * u[c + l];
+                f32 y = j - dt0 * v[c + l];
+
+                if (x < 0.5f) x = 0.5f;
+                if (x > FLUID_SIZE + 0.5f) x = FLUID_SIZE + 0.5f;
+                if (y < 0.5f) y = 0.5f;
+                if (y > FLUID_SIZE + 0.5f) y = FLUID_SIZE + 0.5f;
+
+                i32 i0 = x;
+                i32 i1 = i0 + 1;
+                i32 j0 = y;
+                i32 j1 = j0 + 1;
+
+                f32 s1 = x - i0;
+                f32 s0 = 1 - s1;
+                f32 t1 = y - j0;
+                f32 t0 = 1 - t1;
+
+                d[c + l] = s0 * (t0 * d0[EnsembleIX(i0, j0) + l] +
+                    t1 * d0[EnsembleIX(i0, j1) + l]) +
+                    s1 * (t0 * d0[EnsembleIX(i1, j0) + l] +
+                    t1 * d0[EnsembleIX(i1, j1) + l]);
+            }
+        }
+    }
+    EnsembleSetBound(b, d, block);
+}
+
+static inline void EnsemblePressureCell(
+    f32* restrict p, const f32* restrict div,
+    const f32* restrict left, const f32* restrict right,
+    const f32* restrict up, const f32* restrict down
+) {
+    for (u32 l = 0; l < LANES; l++) {
+        p[l] = (div[l] + left[l] + right[l] + up[l] + down[l]) / 4;
+    }
+}
+
+static void EnsembleProject(f32* restrict u, f32* restrict v, f32* restrict p, f32* restrict div, FluidEnsembleBlock* block) {
+    f32 h = 1.0 / FLUID_SIZE;
+    for (i32 i = 1; i <= FLUID_SIZE; i++) {
+        for (i32 j = 1; j <= FLUID_SIZE; j++) {
+            i32 c = EnsembleIX(i, j);
+            for (u32 l = 0; l < LANES; l++) {
+                div[c + l] = -0.5f * h * (
+                    u[EnsembleIX(i + 1, j) + l] - u[EnsembleIX(i - 1, j) + l] +
+                    v[EnsembleIX(i, j + 1) + l] - v[EnsembleIX(i, j - 1) + l]
+                );
+                p[c + l] = 0;
+            }
+        }
+    }
+    EnsembleSetBound(0, div, block);
+    EnsembleSetBound(0, p, block);
+    for (i32 k = 0; k < 20; k++) {
+        for (i32 i = 1; i <= FLUID_SIZE; i++) {
+            for (i32 j = 1; j <= FLUID_SIZE; j++) {
+                EnsemblePressureCell(
+                    p + EnsembleIX(i, j), div + EnsembleIX(i, j),
+                    p + EnsembleIX(i - 1, j), p + EnsembleIX(i + 1, j),
+                    p + EnsembleIX(i, j - 1), p + EnsembleIX(i, j + 1)
+                );
+            }
+        }
+        EnsembleSetBound(0, p, block);
+    }
+    for (i32 i = 1; i <= FLUID_SIZE; i++) {
+        for (i32 j = 1; j <= FLUID_SIZE; j++) {
+            i32 c = EnsembleIX(i, j);
+            for (u32 l = 0; l < LANES; l++) {
+                u[c + l] -= 0.5f * (
+                    p[EnsembleIX(i + 1, j) + l] - p[EnsembleIX(i - 1, j) + l]
+                ) / h;
+                v[c + l] -= 0.5f * (
+                    p[EnsembleIX(i, j + 1) + l] - p[EnsembleIX(i, j - 1) + l]
+                ) / h;
+            }
+        }
+    }
+    EnsembleSetBound(1, u, block);
+    EnsembleSetBound(2, v, block);
+}
+
+static void EnsembleDensityStep(FluidEnsembleBlock* block) {
+    f32* x = block->dens;
+    f32* x0 = block->dens_prev;
+    EnsembleAddSource(x, x0);
+    SWAP(x0, x);
+    EnsembleDiffuse(0, x, x0, block->diff, block);
+    SWAP(x0, x);
+    EnsembleAdvect(0, x, x0, block->u, block->v, block);
+}
+
+static void EnsembleVelocityStep(FluidEnsembleBlock* block) {
+    f32* u = block->u;
+    f32* v = block->v;
+    f32* u0 = block->u_prev;
+    f32* v0 = block->v_prev;
+    EnsembleAddSource(u, u0);
+    EnsembleAddSource(v, v0);
+    SWAP(u0, u);
+    EnsembleDiffuse(1, u, u0, block->visc, block);
+    SWAP(v0, v);
+    EnsembleDiffuse(2, v, v0, block->visc, block);
+    EnsembleProject(u, v, u0, v0, block);
+    SWAP(u0, u);
+    SWAP(v0, v);
+    EnsembleAdvect(1, u, u0, u0, v0, block);
+    EnsembleAdvect(2, v, v0, u0, v0, block);
+    EnsembleProject(u, v, u0, v0, block);
+}
+
+static void EnsembleStepBlock(void* data, u32 index) {
+    FluidEnsemble* ensemble = data;
+    FluidEnsembleBlock* block = &ensemble->blocks[index];
+
+    EnsembleFindSolidCells(block);
+    EnsembleVelocityStep(block);
+    EnsembleDensityStep(block);
+
+    memset(block->dens_prev, 0, sizeof(f32) * ENSEMBLE_FIELD_SIZE);
+    memset(block->u_prev, 0, sizeof(f32) * ENSEMBLE_FIELD_SIZE);
+    memset(block->v_prev, 0, sizeof(f32) * ENSEMBLE_FIELD_SIZE);
+}
+
+void FluidEnsembleStep(FluidEnsemble* ensemble, ThreadPool* pool) {
+    if (pool) {
+        ThreadPoolFor(pool, EnsembleStepBlock, ensemble, ensemble->block_count);
+    } else {
+        for (u32 i = 0; i < ensemble->block_count; i++) {
+            EnsembleStepBlock(ensemble, i);
+        }
+    }
+}
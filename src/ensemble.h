@@ -0,0 +1,41 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "core.h"
+#include "fluid.h"
+
+// Many independent fluid grids stepped together. Grids are packed into blocks
+// of FLUID_ENSEMBLE_LANES with every field interleaved by lane, so element
+// [FluidIX(x, y) * FLUID_ENSEMBLE_LANES + lane] of a block field is cell (x, y)
+// of grid (block * FLUID_ENSEMBLE_LANES + lane). The inner loop of every kernel
+// runs across lanes which lets the compiler vectorise it, and blocks are
+// stepped in parallel on a ThreadPool.
+#define FLUID_ENSEMBLE_LANES 8
+
+typedef struct {
+    f32* u;
+    f32* v;
+    f32* u_prev;
+    f32* v_prev;
+    f32* dens;
+    f32* dens_prev;
+    bool* solid;
+    u32* solid_cells;
+    u32 solid_cell_count;
+    f32 visc[FLUID_ENSEMBLE_LANES];
+    f32 diff[FLUID_ENSEMBLE_LANES];
+} FluidEnsembleBlock;
+
+typedef struct {
+    u32 count;
+    u32 block_count;
+    FluidEnsembleBlock* blocks;
+} FluidEnsemble;
+
+FluidEnsemble* FluidEnsembleCreate(Arena* arena, u32 count);
+void FluidEnsembleSetParams(FluidEnsemble* ensemble, u32 index, f32 visc, f32 diff);
+void FluidEnsembleLoad(FluidEnsemble* ensemble, u32 index, FluidGrid* fluid);
+void FluidEnsembleStore(FluidEnsemble* ensemble, u32 index, FluidGrid* fluid);
+void FluidEnsembleStep(FluidEnsemble* ensemble, ThreadPool* pool);
+
+#endif // ENSEMBLE_H
@@ -1,8 +1,6 @@
 // https://graphics.cs.cmu.edu/nsp/course/15-464/Fall09/papers/StamFluidforGames.pdf
 #include "fluid.h"
 
-#define SWAP(x0, x) {f32* tmp = x0; x0 = x; x = tmp;}
-
 i32 FluidIX(i32 x, i32 y) {
     return y * FLUID_SIZE_BUFFERED + x;
 }
@@ -109,32 +107,21 @@ static void FluidDiffuse(i32 b, f32* x, f32* x0, f32 diff, bool* solid) {
     }
 }
 
+// Bilinear sample of field d at any position in cells, clamped to the centre
+// of the border cells
+static inline f32 FluidSample(f32* d, f32 x, f32 y) {
+    x = Clamp(x, 0.5f, FLUID_SIZE + 0.5f);
+    y = Clamp(y, 0.5f, FLUID_SIZE + 0.5f);
+    return FluidSampleInRange(d, x, y);
+}
+
 static void FluidAdvect(i32 b, f32* d, f32* d0, f32* u, f32* v, bool* solid) {
     f32 dt0 = FIXED_DT * FLUID_SIZE;
     for (i32 i = 1; i <= FLUID_SIZE; i++) {
         for (i32 j = 1; j <= FLUID_SIZE; j++) {
             f32 x = i - dt0 * u[FluidIX(i, j)];
             f32 y = j - dt0 * v[FluidIX(i, j)];
-
-            if (x < 0.5f) x = 0.5f;
-            if (x > FLUID_SIZE + 0.5f) x = FLUID_SIZE + 0.5f;
-            if (y < 0.5f) y = 0.5f;
-            if (y > FLUID_SIZE + 0.5f) y = FLUID_SIZE + 0.5f;
-
-            i32 i0 = x;
-            i32 i1 = i0 + 1;
-            i32 j0 = y;
-            i32 j1 = j0 + 1;
-
-            f32 s1 = x - i0;
-            f32 s0 = 1 - s1;
-            f32 t1 = y - j0;
-            f32 t0 = 1 - t1;
-
-            d[FluidIX(i, j)] = s0 * (t0 * d0[FluidIX(i0, j0)] +
-                t1 * d0[FluidIX(i0, j1)]) +
-                s1 * (t0 * d0[FluidIX(i1, j0)] +
-                t1 * d0[FluidIX(i1, j1)]);
+            d[FluidIX(i, j)] = FluidSample(d0, x, y);
         }
     }
     FluidSetBound(b, d, solid);
@@ -181,25 +168,108 @@ static void FluidProject(f32* u, f32* v, f32* p, f32* div, bool* solid) {
     FluidSetBound(2, v, solid);
 }
 
+// Diffuse and advect x, which already has its sources added. x_tmp holds the
+// starting guess for the diffusion and is overwritten
+static void FluidDensitySolve(f32* x, f32* x_tmp, f32* u, f32* v, f32 diff, bool* solid) {
+    FluidDiffuse(0, x_tmp, x, diff, solid);
+    FluidAdvect(0, x, x_tmp, u, v, solid);
+}
+
+// Same for the velocity, u_tmp and v_tmp are also used by the projections
+static void FluidVelocitySolve(f32* u, f32* v, f32* u_tmp, f32* v_tmp, f32 visc, bool* solid) {
+    FluidDiffuse(1, u_tmp, u, visc, solid);
+    FluidDiffuse(2, v_tmp, v, visc, solid);
+    FluidProject(u_tmp, v_tmp, u, v, solid);
+    FluidAdvect(1, u, u_tmp, u_tmp, v_tmp, solid);
+    FluidAdvect(2, v, v_tmp, u_tmp, v_tmp, solid);
+    FluidProject(u, v, u_tmp, v_tmp, solid);
+}
+
 void FluidDensityStep(f32* x, f32* x0, f32* u, f32* v, f32 diff, bool* solid) {
     FluidAddSource(x, x0);
-    SWAP(x0, x);
-    FluidDiffuse(0, x, x0, diff, solid);
-    SWAP(x0, x);
-    FluidAdvect(0, x, x0, u, v, solid);
+    FluidDensitySolve(x, x0, u, v, diff, solid);
 }
 
 void FluidVelocityStep(f32* u, f32* v, f32* u0, f32* v0, f32 visc, bool* solid) {
     FluidAddSource(u, u0);
     FluidAddSource(v, v0);
-    SWAP(u0, u);
-    FluidDiffuse(1, u, u0, visc, solid);
-    SWAP(v0, v);
-    FluidDiffuse(2, v, v0, visc, solid);
-    FluidProject(u, v, u0, v0, solid);
-    SWAP(u0, u);
-    SWAP(v0, v);
-    FluidAdvect(1, u, u0, u0, v0, solid);
-    FluidAdvect(2, v, v0, u0, v0, solid);
-    FluidProject(u, v, u0, v0, solid);
+    FluidVelocitySolve(u, v, u0, v0, visc, solid);
+}
+
+void FluidGridStep(FluidGrid* fluid, f32 visc, f32 diff) {
+    FluidVelocityStep(fluid->u, fluid->v, fluid->u_prev, fluid->v_prev, visc, fluid->solid);
+    FluidDensityStep(fluid->dens, fluid->dens_prev, fluid->u, fluid->v, diff, fluid->solid);
+    FluidGridClearChanges(fluid);
+}
+
+FluidGridHalf* FluidGridHalfCreate(Arena* arena) {
+    FluidGridHalf* half = ArenaPushStruct(arena, FluidGridHalf);
+    half->u = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->v = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->u_prev = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->v_prev = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->dens = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->dens_prev = ArenaPushArray(arena, f16, FLUID_CELLS_BUFFERED);
+    half->solid = ArenaPushArray(arena, bool, FLUID_CELLS_BUFFERED);
+    return half;
+}
+
+void FluidGridHalfPack(FluidGridHalf* half, FluidGrid* fluid) {
+    HalfFromF32Array(half->u, fluid->u, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->v, fluid->v, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->u_prev, fluid->u_prev, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->v_prev, fluid->v_prev, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->dens, fluid->dens, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->dens_prev, fluid->dens_prev, FLUID_CELLS_BUFFERED);
+    memcpy(half->solid, fluid->solid, sizeof(bool) * FLUID_CELLS_BUFFERED);
+}
+
+void FluidGridHalfUnpack(FluidGridHalf* half, FluidGrid* fluid) {
+    HalfToF32Array(fluid->u, half->u, FLUID_CELLS_BUFFERED);
+    HalfToF32Array(fluid->v, half->v, FLUID_CELLS_BUFFERED);
+    HalfToF32Array(fluid->u_prev, half->u_prev, FLUID_CELLS_BUFFERED);
+    HalfToF32Array(fluid->v_prev, half->v_prev, FLUID_CELLS_BUFFERED);
+    HalfToF32Array(fluid->dens, half->dens, FLUID_CELLS_BUFFERED);
+    HalfToF32Array(fluid->dens_prev, half->dens_prev, FLUID_CELLS_BUFFERED);
+    memcpy(fluid->solid, half->solid, sizeof(bool) * FLUID_CELLS_BUFFERED);
+}
+
+void FluidGridHalfPackChanges(FluidGridHalf* half, FluidGrid* fluid) {
+    HalfFromF32Array(half->u_prev, fluid->u_prev, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->v_prev, fluid->v_prev, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->dens_prev, fluid->dens_prev, FLUID_CELLS_BUFFERED);
+    memcpy(half->solid, fluid->solid, sizeof(bool) * FLUID_CELLS_BUFFERED);
+}
+
+// FluidAddSource reading the stored field and its sources as halves. Writes
+// x = stored + sources * dt and x_tmp = sources, the same arrays the f32 step
+// has before solving. Goes a row at a time so the converted row is still in
+// L1 when the sources are added
+static void FluidAddSourceHalf(f32* x, f32* x_tmp, f16* stored, f16* source) {
+    for (i32 j = 0; j < FLUID_SIZE_BUFFERED; j++) {
+        i32 start = j * FLUID_SIZE_BUFFERED;
+        HalfToF32Array(x + start, stored + start, FLUID_SIZE_BUFFERED);
+        HalfToF32Array(x_tmp + start, source + start, FLUID_SIZE_BUFFERED);
+        for (i32 i = start; i < start + FLUID_SIZE_BUFFERED; i++) {
+            x[i] += x_tmp[i] * FIXED_DT;
+        }
+    }
+}
+
+void FluidGridHalfStep(FluidGridHalf* half, FluidGrid* scratch, f32 visc, f32 diff) {
+    FluidAddSourceHalf(scratch->u, scratch->u_prev, half->u, half->u_prev);
+    FluidAddSourceHalf(scratch->v, scratch->v_prev, half->v, half->v_prev);
+    FluidVelocitySolve(scratch->u, scratch->v, scratch->u_prev, scratch->v_prev, visc, half->solid);
+
+    FluidAddSourceHalf(scratch->dens, scratch->dens_prev, half->dens, half->dens_prev);
+    FluidDensitySolve(scratch->dens, scratch->dens_prev, scratch->u, scratch->v, diff, half->solid);
+
+    HalfFromF32Array(half->u, scratch->u, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->v, scratch->v, FLUID_CELLS_BUFFERED);
+    HalfFromF32Array(half->dens, scratch->dens, FLUID_CELLS_BUFFERED);
+
+    // Sources are used up by a step, same as FluidGridClearChanges
+    memset(half->u_prev, 0, sizeof(f16) * FLUID_CELLS_BUFFERED);
+    memset(half->v_prev, 0, sizeof(f16) * FLUID_CELLS_BUFFERED);
+    memset(half->dens_prev, 0, sizeof(f16) * FLUID_CELLS_BUFFERED);
 }
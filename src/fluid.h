@@ -14,12 +14,53 @@ typedef struct {
     bool* solid;
 } FluidGrid;
 
+// Same state stored as half floats, for keeping many grids resident at half
+// the memory. Only the add source pass reads halves, converting them into a
+// scratch FluidGrid that stays in cache. Diffuse, advect and project then run
+// on the f32 scratch as usual and u, v and dens are stored back as halves.
+// Scratch is left holding the f32 result in u, v and dens for drawing, its
+// other fields are overwritten
+typedef struct {
+    f16* u;
+    f16* v;
+    f16* u_prev;
+    f16* v_prev;
+    f16* dens;
+    f16* dens_prev;
+    bool* solid;
+} FluidGridHalf;
+
 static const u32 FLUID_CELL_PIXELS = 8;
 static const u32 FLUID_SIZE = 64;
 static const u32 FLUID_SIZE_BUFFERED = FLUID_SIZE + 2;
 static const u32 FLUID_CELLS = FLUID_SIZE * FLUID_SIZE;
 static const u32 FLUID_CELLS_BUFFERED = FLUID_SIZE_BUFFERED * FLUID_SIZE_BUFFERED;
 
+// Bilinear sample of field d at a position in cells that is already within
+// [0.5, FLUID_SIZE + 0.5]. Clamping the indices rather than the position keeps
+// the loads in bounds without float compares, which could trap and so stop gcc
+// if-converting and vectorising loops around it. Inline so kernels in other
+// files, such as the tracer step, can vectorise around it
+static inline f32 FluidSampleInRange(f32* d, f32 x, f32 y) {
+    i32 i0 = x;
+    i32 j0 = y;
+
+    f32 s1 = x - i0;
+    f32 s0 = 1 - s1;
+    f32 t1 = y - j0;
+    f32 t0 = 1 - t1;
+
+    i0 = Clamp(i0, 0, (i32)FLUID_SIZE);
+    j0 = Clamp(j0, 0, (i32)FLUID_SIZE);
+    i32 i1 = i0 + 1;
+    i32 j1 = j0 + 1;
+
+    return s0 * (t0 * d[j0 * FLUID_SIZE_BUFFERED + i0] +
+        t1 * d[j1 * FLUID_SIZE_BUFFERED + i0]) +
+        s1 * (t0 * d[j0 * FLUID_SIZE_BUFFERED + i1] +
+        t1 * d[j1 * FLUID_SIZE_BUFFERED + i1]);
+}
+
 i32 FluidIX(i32 x, i32 y);
 bool FluidIN(f32 x, f32 y);
 FluidGrid* FluidGridCreate(Arena* arena);
@@ -27,5 +68,12 @@ void FluidGridClearChanges(FluidGrid* fluid);
 void FluidGridReset(FluidGrid* fluid);
 void FluidDensityStep(f32* x, f32* x0, f32* u, f32* v, f32 diff, bool* solid);
 void FluidVelocityStep(f32* u, f32* v, f32* u0, f32* v0, f32 visc, bool* solid);
+void FluidGridStep(FluidGrid* fluid, f32 visc, f32 diff);
+
+FluidGridHalf* FluidGridHalfCreate(Arena* arena);
+void FluidGridHalfPack(FluidGridHalf* half, FluidGrid* fluid);
+void FluidGridHalfUnpack(FluidGridHalf* half, FluidGrid* fluid);
+void FluidGridHalfPackChanges(FluidGridHalf* half, FluidGrid* fluid);
+void FluidGridHalfStep(FluidGridHalf* half, FluidGrid* scratch, f32 visc, f32 diff);
 
 #endif // FLUID_H
@@ -1,19 +1,118 @@
 #include "core.h"
 #include "constants.h"
 #include "fluid.h"
+#include "particles.h"
+#include "publish.h"
+
+typedef struct {
+    FluidGrid* fluid;
+    FluidGridHalf* half;
+    FluidParticles* particles;
+    FluidPublisher* publisher;
+    ThreadPool* particle_pool;
+    f32 visc;
+    f32 diff;
+    u32 steps;
+} FluidStepJob;
+
+static const u32 TEXTURE_WIDTH = FLUID_CELL_PIXELS * FLUID_SIZE_BUFFERED;
+static const u32 TEXTURE_HEIGHT = FLUID_CELL_PIXELS * FLUID_SIZE_BUFFERED;
+
+static void FluidStepTask(void* data, u32 index) {
+    FluidStepJob* job = data;
+    if (job->steps == 0) { return; }
+
+    // Input always goes into the f32 grid, which with half storage is then
+    // used as the scratch grid and holds the result to draw
+    if (job->half) { FluidGridHalfPackChanges(job->half, job->fluid); }
+
+    for (u32 i = 0; i < job->steps; i++) {
+        if (job->half) {
+            FluidGridHalfStep(job->half, job->fluid, job->visc, job->diff);
+        } else {
+            FluidGridStep(job->fluid, job->visc, job->diff);
+        }
+        FluidParticlesStep(job->particles, job->fluid, job->particle_pool);
+        if (job->publisher) { FluidPublisherWrite(job->publisher, job->fluid); }
+    }
+
+    // Solver leaves its working values in the sources, start input from zero
+    if (job->half) { FluidGridClearChanges(job->fluid); }
+}
+
+static void FluidUpdateTexture(FluidGrid* fluid, FluidParticles* particles, Color* pixels, Texture2D texture) {
+    for (i32 y = 0; y < FLUID_SIZE_BUFFERED; y++) {
+        for (i32 x = 0; x < FLUID_SIZE_BUFFERED; x++) {
+            i32 grid_index = x + y * TEXTURE_WIDTH;
+            f32 density = Clamp(fluid->dens[FluidIX(x, y)], 0.0f, 1.0f);
+            Color c = WHITE;
+            if (!fluid->solid[(FluidIX(x, y))]) {
+                c = (Color) {
+                    (u8)(density * density * density * 128),
+                    (u8)(density * density * 255),
+                    (u8)(density * 255),
+                    255
+                };
+            }
+            pixels[grid_index] = c;
+        }
+    }
+    FluidParticlesSplat(particles, pixels, TEXTURE_WIDTH);
+    UpdateTexture(texture, pixels);
+}
 
-int main(void) {
+int main(int argc, char** argv) {
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_CAPTION);
     SetTargetFPS(WINDOW_FPS);
     SetRandomSeed(0);
 
+#ifdef PLATFORM_WEB
+    // Emscripten's mmap allocates the whole reserve so keep it small
+    Arena* arena = ArenaCreate(MiB(16), MiB(1));
+#else
     Arena* arena = ArenaCreate(GiB(1), MiB(1));
+#endif
 
     FluidGrid* fluid = FluidGridCreate(arena);
+    FluidParticles* particles = FluidParticlesCreate(arena, Thousand(100));
+    RNG rng = PCG32_INITIALIZER;
+
+    // Optionally export every step to shared memory for other processes and
+    // keep the grid in half precision between steps
+    FluidPublisher* publisher = NULL;
+    FluidGridHalf* half = NULL;
+    for (i32 i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--publish") == 0) {
+            bool has_name = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0;
+            const char* name = has_name ? argv[++i] : FLUID_SHM_DEFAULT_NAME;
+            publisher = FluidPublisherCreate(arena, name);
+            if (!publisher) { printf("[ FAILED ] Unable to publish to shared memory %s\n", name); }
+        } else if (strcmp(argv[i], "--half") == 0) {
+            half = FluidGridHalfCreate(arena);
+        }
+    }
+
+#ifdef PLATFORM_WEB
+    // The browser main thread must not block for long, so the simulation runs
+    // on a Web Worker while the main thread draws the previous frame's steps.
+    // Tracers get a pool of their own as pools can not be nested.
+    // NOTE: Threads of both pools together must match PTHREAD_POOL_SIZE in build.sh
+    ThreadPool* pool = ThreadPoolCreate(arena, 1);
+    ThreadPool* particle_pool = ThreadPoolCreate(arena, 2);
+#else
+    // Thread stepping the simulation helps out in ThreadPoolWait
+    ThreadPool* particle_pool = ThreadPoolCreate(arena, OS_CoreCount() - 1);
+#endif
+
+    FluidStepJob job = {
+        .fluid = fluid,
+        .half = half,
+        .particles = particles,
+        .publisher = publisher,
+        .particle_pool = particle_pool,
+    };
 
-    static const u32 TEXTURE_WIDTH = FLUID_CELL_PIXELS * FLUID_SIZE_BUFFERED;
-    static const u32 TEXTURE_HEIGHT = FLUID_CELL_PIXELS * FLUID_SIZE_BUFFERED;
     Color* pixels = ArenaPushArray(arena, Color, TEXTURE_WIDTH * TEXTURE_HEIGHT);
     Image* image = ArenaPushStruct(arena, Image);
     image->data = pixels;
@@ -37,6 +136,13 @@ int main(void) {
         f32 dt = GetFrameTime();
         accumulator += dt;
 
+#ifdef PLATFORM_WEB
+        // Grid can not be touched until last frame's steps have finished.
+        // Only block, taking over the steps would stall the page instead
+        ThreadPoolWaitWorkers(pool);
+        bool fluid_updated = job.steps > 0;
+#endif
+
         // User interaction
         last_mouse_pos = mouse_pos;
         mouse_pos = GetMousePosition();
@@ -45,7 +151,11 @@ int main(void) {
             mouse_pos.y / FLUID_CELL_PIXELS,
         };
 
-        if (IsKeyPressed(KEY_SPACE)) { FluidGridReset(fluid); }
+        if (IsKeyPressed(KEY_SPACE)) {
+            FluidGridReset(fluid);
+            FluidParticlesReset(particles);
+            if (half) { FluidGridHalfPack(half, fluid); }
+        }
 
         if (FluidIN(mouse_fluid_cell_pos.x, mouse_fluid_cell_pos.y)) {
             i32 grid_index = FluidIX(mouse_fluid_cell_pos.x, mouse_fluid_cell_pos.y);
@@ -55,6 +165,12 @@ int main(void) {
                 fluid->dens_prev[grid_index] = 20.0f;
                 fluid->u_prev[grid_index] += mouse_vel.x;
                 fluid->v_prev[grid_index] += mouse_vel.y;
+
+                Vector2 cell_pos = (Vector2) {
+                    mouse_pos.x / FLUID_CELL_PIXELS - 0.5f,
+                    mouse_pos.y / FLUID_CELL_PIXELS - 0.5f,
+                };
+                FluidParticlesEmit(particles, &rng, cell_pos, 1.0f, 500);
             }
 
             if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
@@ -63,35 +179,24 @@ int main(void) {
         }
 
         // Simulate
-        bool fluid_updated = false;
+        job.visc = visc;
+        job.diff = diff;
+        job.steps = 0;
         while(accumulator >= FIXED_DT) {
-            FluidVelocityStep(fluid->u, fluid->v, fluid->u_prev, fluid->v_prev, visc, fluid->solid);
-            FluidDensityStep(fluid->dens, fluid->dens_prev, fluid->u, fluid->v, diff, fluid->solid);
-            FluidGridClearChanges(fluid);
             accumulator -= FIXED_DT;
-            fluid_updated = true;
+            job.steps++;
         }
 
-        if (fluid_updated) {
-            // Update render texture once for final state
-            for (i32 y = 0; y < FLUID_SIZE_BUFFERED; y++) {
-                for (i32 x = 0; x < FLUID_SIZE_BUFFERED; x++) {
-                    i32 grid_index = x + y * TEXTURE_WIDTH;
-                    f32 density = Clamp(fluid->dens[FluidIX(x, y)], 0.0f, 1.0f);
-                    Color c = WHITE;
-                    if (!fluid->solid[(FluidIX(x, y))]) {
-                        c = (Color) {
-                            (u8)(density * density * density * 128),
-                            (u8)(density * density * 255),
-                            (u8)(density * 255),
-                            255
-                        };
-                    }
-                    pixels[grid_index] = c;
-                }
-            }
-            UpdateTexture(texture, pixels);
-        }
+#ifdef PLATFORM_WEB
+        // Update render texture once for final state
+        if (fluid_updated) { FluidUpdateTexture(fluid, particles, pixels, texture); }
+        ThreadPoolDispatch(pool, FluidStepTask, &job, (job.steps > 0) ? 1 : 0);
+#else
+        FluidStepTask(&job, 0);
+
+        // Update render texture once for final state
+        if (job.steps > 0) { FluidUpdateTexture(fluid, particles, pixels, texture); }
+#endif
 
         BeginDrawing();
         ClearBackground(BLACK);
@@ -100,5 +205,11 @@ int main(void) {
         EndDrawing();
     }
 
+#ifdef PLATFORM_WEB
+    ThreadPoolWaitWorkers(pool);
+    ThreadPoolDestroy(pool);
+#endif
+    ThreadPoolDestroy(particle_pool);
+    if (publisher) { FluidPublisherDestroy(publisher); }
     CloseWindow();
 }
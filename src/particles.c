@@ -0,0 +1,183 @@
+#include "particles.h"
+
+#define SWAP(x0, x) {f32* tmp = x0; x0 = x; x = tmp;}
+
+// Particles sampled at a time, a fixed count so the loop vectorises at -O2
+#define PARTICLES_BATCH 256
+
+typedef struct {
+    FluidParticles* particles;
+    FluidGrid* fluid;
+} ParticlesStepJob;
+
+static inline i32 ParticleCell(f32 x, f32 y) {
+    return (i32)(y + 0.5f) * FLUID_SIZE_BUFFERED + (i32)(x + 0.5f);
+}
+
+FluidParticles* FluidParticlesCreate(Arena* arena, u32 capacity) {
+    FluidParticles* particles = ArenaPushStruct(arena, FluidParticles);
+    particles->x = ArenaPushArrayNonZero(arena, f32, capacity);
+    particles->y = ArenaPushArrayNonZero(arena, f32, capacity);
+    particles->x_sorted = ArenaPushArrayNonZero(arena, f32, capacity);
+    particles->y_sorted = ArenaPushArrayNonZero(arena, f32, capacity);
+    particles->cell_start = ArenaPushArray(arena, u32, FLUID_CELLS_BUFFERED + 1);
+    particles->capacity = capacity;
+    return particles;
+}
+
+void FluidParticlesReset(FluidParticles* particles) {
+    particles->count = 0;
+    particles->next = 0;
+    particles->steps_since_sort = 0;
+}
+
+void FluidParticlesEmit(FluidParticles* particles, RNG* rng, Vector2 position, f32 radius, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        Vector2 p = RandomCircle(rng, position, radius);
+
+        // Recycle the oldest slot once full
+        u32 index = particles->count;
+        if (particles->count < particles->capacity) {
+            particles->count++;
+        } else {
+            index = particles->next;
+            particles->next = (particles->next + 1) % particles->capacity;
+        }
+
+        particles->x[index] = Clamp(p.x, 0.5f, FLUID_SIZE + 0.5f);
+        particles->y[index] = Clamp(p.y, 0.5f, FLUID_SIZE + 0.5f);
+    }
+}
+
+// Move by (dx, dy), stopping at the last position before a wall. Goes at most
+// one cell per axis at a time so a wall one cell thick can not be jumped over
+static inline void ParticleMove(bool* solid, f32* x, f32* y, f32 dx, f32 dy) {
+    f32 x0 = *x;
+    f32 y0 = *y;
+    dx = Clamp(x0 + dx, 0.5f, FLUID_SIZE + 0.5f) - x0;
+    dy = Clamp(y0 + dy, 0.5f, FLUID_SIZE + 0.5f) - y0;
+
+    // Usual case, only the destination can be a wall
+    f32 distance = Max(abs_f32(dx), abs_f32(dy));
+    if (distance <= 1.0f) {
+        if (!solid[ParticleCell(x0 + dx, y0 + dy)]) {
+            *x = x0 + dx;
+            *y = y0 + dy;
+        }
+        return;
+    }
+
+    u32 substeps = ceil_f32(distance);
+    for (u32 s = 1; s <= substeps; s++) {
+        f32 t = (f32)s / substeps;
+        f32 nx = x0 + t * dx;
+        f32 ny = y0 + t * dy;
+        if (solid[ParticleCell(nx, ny)]) { break; }
+        *x = nx;
+        *y = ny;
+    }
+}
+
+static void ParticlesStepTask(void* data, u32 index) {
+    ParticlesStepJob* job = data;
+    FluidParticles* particles = job->particles;
+    f32* xs = particles->x;
+    f32* ys = particles->y;
+    f32* u = job->fluid->u;
+    f32* v = job->fluid->v;
+    bool* solid = job->fluid->solid;
+
+    u32 start = index * PARTICLES_PER_TASK;
+    u32 end = Min(start + PARTICLES_PER_TASK, particles->count);
+
+    // Forward Euler with the same velocity scaling as FluidAdvect. Sampling
+    // is done a fixed size batch at a time and without branches so it
+    // vectorises, with the grid loads as gathers or per lane loads depending
+    // on the target. Walls are then handled one particle at a time
+    f32 dt0 = FIXED_DT * FLUID_SIZE;
+    f32 bx[PARTICLES_BATCH];
+    f32 by[PARTICLES_BATCH];
+    f32 dx[PARTICLES_BATCH];
+    f32 dy[PARTICLES_BATCH];
+    for (u32 batch = start; batch < end; batch += PARTICLES_BATCH) {
+        u32 count = Min(PARTICLES_BATCH, end - batch);
+
+        memcpy(bx, xs + batch, sizeof(f32) * count);
+        memcpy(by, ys + batch, sizeof(f32) * count);
+
+        // Pad a short last batch with a valid position
+        for (u32 i = count; i < PARTICLES_BATCH; i++) {
+            bx[i] = 1.0f;
+            by[i] = 1.0f;
+        }
+
+        for (u32 i = 0; i < PARTICLES_BATCH; i++) {
+            dx[i] = dt0 * FluidSampleInRange(u, bx[i], by[i]);
+            dy[i] = dt0 * FluidSampleInRange(v, bx[i], by[i]);
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            ParticleMove(solid, &xs[batch + i], &ys[batch + i], dx[i], dy[i]);
+        }
+    }
+}
+
+void FluidParticlesStep(FluidParticles* particles, FluidGrid* fluid, ThreadPool* pool) {
+    ParticlesStepJob job = { particles, fluid };
+    u32 task_count = (particles->count + PARTICLES_PER_TASK - 1) / PARTICLES_PER_TASK;
+
+    if (pool) {
+        ThreadPoolFor(pool, ParticlesStepTask, &job, task_count);
+    } else {
+        for (u32 i = 0; i < task_count; i++) {
+            ParticlesStepTask(&job, i);
+        }
+    }
+
+    // Keep particles in the same cell next to each other in memory so the
+    // sampler's gathers stay within a few cache lines
+    particles->steps_since_sort++;
+    if (particles->steps_since_sort >= PARTICLES_SORT_INTERVAL) {
+        FluidParticlesSort(particles);
+    }
+}
+
+// Counting sort by cell
+// NOTE: Reorders the particles so recycling no longer goes oldest first
+void FluidParticlesSort(FluidParticles* particles) {
+    u32* cell_start = particles->cell_start;
+    memset(cell_start, 0, sizeof(u32) * (FLUID_CELLS_BUFFERED + 1));
+
+    for (u32 i = 0; i < particles->count; i++) {
+        cell_start[ParticleCell(particles->x[i], particles->y[i]) + 1]++;
+    }
+
+    for (u32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        cell_start[i + 1] += cell_start[i];
+    }
+
+    for (u32 i = 0; i < particles->count; i++) {
+        f32 x = particles->x[i];
+        f32 y = particles->y[i];
+        u32 index = cell_start[ParticleCell(x, y)]++;
+        particles->x_sorted[index] = x;
+        particles->y_sorted[index] = y;
+    }
+
+    SWAP(particles->x, particles->x_sorted);
+    SWAP(particles->y, particles->y_sorted);
+    particles->steps_since_sort = 0;
+}
+
+// Brighten the texture pixel of every cell a particle is in. Expects one
+// pixel per grid cell laid out like main.c's render texture
+void FluidParticlesSplat(FluidParticles* particles, Color* pixels, u32 stride) {
+    for (u32 i = 0; i < particles->count; i++) {
+        i32 x = particles->x[i] + 0.5f;
+        i32 y = particles->y[i] + 0.5f;
+        Color* c = &pixels[x + y * stride];
+        c->r = Min(c->r + 24, 255);
+        c->g = Min(c->g + 24, 255);
+        c->b = Min(c->b + 24, 255);
+    }
+}
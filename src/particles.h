@@ -0,0 +1,33 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "core.h"
+#include "fluid.h"
+
+// Massless tracers carried by a FluidGrid's velocity field. Positions are in
+// cells, so a particle at (x, y) is in cell FluidIX(x + 0.5f, y + 0.5f). All
+// storage comes from the arena up front; once full, emitting overwrites the
+// existing particles in turn instead of growing.
+typedef struct {
+    f32* x;
+    f32* y;
+    f32* x_sorted;
+    f32* y_sorted;
+    u32* cell_start;
+    u32 capacity;
+    u32 count;
+    u32 next;
+    u32 steps_since_sort;
+} FluidParticles;
+
+static const u32 PARTICLES_PER_TASK = 16384;
+static const u32 PARTICLES_SORT_INTERVAL = 32;
+
+FluidParticles* FluidParticlesCreate(Arena* arena, u32 capacity);
+void FluidParticlesReset(FluidParticles* particles);
+void FluidParticlesEmit(FluidParticles* particles, RNG* rng, Vector2 position, f32 radius, u32 count);
+void FluidParticlesStep(FluidParticles* particles, FluidGrid* fluid, ThreadPool* pool);
+void FluidParticlesSort(FluidParticles* particles);
+void FluidParticlesSplat(FluidParticles* particles, Color* pixels, u32 stride);
+
+#endif // PARTICLES_H
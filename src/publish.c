@@ -0,0 +1,178 @@
+#include "publish.h"
+
+#if defined(_WIN32) || defined(PLATFORM_WEB)
+
+FluidPublisher* FluidPublisherCreate(Arena* arena, const char* name) { return NULL; }
+void FluidPublisherDestroy(FluidPublisher* publisher) {}
+void FluidPublisherWrite(FluidPublisher* publisher, FluidGrid* fluid) {}
+
+FluidSubscriber* FluidSubscriberOpen(Arena* arena, const char* name) { return NULL; }
+void FluidSubscriberClose(FluidSubscriber* subscriber) {}
+b32 FluidSubscriberBegin(FluidSubscriber* subscriber, FluidShmView* view) { return false; }
+b32 FluidSubscriberEnd(FluidShmView* view) { return false; }
+
+#else
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const u64 SHM_ALIGN = 64;
+
+// Fill in the layout fields of a header and return the total size
+static u64 ShmLayout(FluidShmHeader* header) {
+    u64 field_bytes = sizeof(f32) * FLUID_CELLS_BUFFERED;
+
+    header->magic = FLUID_SHM_MAGIC;
+    header->version = FLUID_SHM_VERSION;
+    header->size_buffered = FLUID_SIZE_BUFFERED;
+    header->frame_count = FLUID_SHM_FRAMES;
+    header->frames_offset = AlignUpPow2(sizeof(FluidShmHeader), SHM_ALIGN);
+    header->dens_offset = AlignUpPow2(sizeof(FluidShmFrame), SHM_ALIGN);
+    header->u_offset = header->dens_offset + AlignUpPow2(field_bytes, SHM_ALIGN);
+    header->v_offset = header->u_offset + AlignUpPow2(field_bytes, SHM_ALIGN);
+    header->solid_offset = header->v_offset + AlignUpPow2(field_bytes, SHM_ALIGN);
+    header->frame_bytes = AlignUpPow2(header->solid_offset + FLUID_CELLS_BUFFERED, SHM_ALIGN);
+
+    return header->frames_offset + header->frame_bytes * FLUID_SHM_FRAMES;
+}
+
+static FluidShmFrame* ShmFrame(FluidShmHeader* header, u64 frame_number) {
+    u64 slot = frame_number % header->frame_count;
+    return (FluidShmFrame*)((u8*)header + header->frames_offset + slot * header->frame_bytes);
+}
+
+// PUBLISHER //////////////////////////////////////////////////////////////////
+FluidPublisher* FluidPublisherCreate(Arena* arena, const char* name) {
+    // Name is kept for shm_unlink, a truncated copy would unlink another object
+    if (strlen(name) >= sizeof(((FluidPublisher*)0)->name)) { return NULL; }
+
+    FluidShmHeader layout = { 0 };
+    u64 size = ShmLayout(&layout);
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) { return NULL; }
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    // Object may be left over from an earlier run so start from scratch
+    memset(mem, 0, size);
+    ShmLayout(mem);
+
+    FluidPublisher* publisher = ArenaPushStruct(arena, FluidPublisher);
+    publisher->fd = fd;
+    publisher->size = size;
+    publisher->header = mem;
+    memcpy(publisher->name, name, strlen(name) + 1);
+    return publisher;
+}
+
+void FluidPublisherDestroy(FluidPublisher* publisher) {
+    munmap(publisher->header, publisher->size);
+    close(publisher->fd);
+    shm_unlink(publisher->name);
+}
+
+void FluidPublisherWrite(FluidPublisher* publisher, FluidGrid* fluid) {
+    FluidShmHeader* header = publisher->header;
+    u64 frame_number = ++publisher->frame;
+    FluidShmFrame* frame = ShmFrame(header, frame_number);
+    u8* base = (u8*)frame;
+
+    // Odd seq marks the slot as being written
+    u64 seq = atomic_load_explicit(&frame->seq, memory_order_relaxed);
+    atomic_store_explicit(&frame->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    frame->frame = frame_number;
+    memcpy(base + header->dens_offset, fluid->dens, sizeof(f32) * FLUID_CELLS_BUFFERED);
+    memcpy(base + header->u_offset, fluid->u, sizeof(f32) * FLUID_CELLS_BUFFERED);
+    memcpy(base + header->v_offset, fluid->v, sizeof(f32) * FLUID_CELLS_BUFFERED);
+    u8* solid = base + header->solid_offset;
+    for (u32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+        solid[i] = fluid->solid[i];
+    }
+
+    atomic_store_explicit(&frame->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&header->latest, frame_number, memory_order_release);
+}
+
+// SUBSCRIBER /////////////////////////////////////////////////////////////////
+FluidSubscriber* FluidSubscriberOpen(Arena* arena, const char* name) {
+    FluidShmHeader layout = { 0 };
+    u64 size = ShmLayout(&layout);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) { return NULL; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (u64)st.st_size < size) {
+        close(fd);
+        return NULL;
+    }
+
+    void* mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    // Refuse a layout this build does not understand
+    FluidShmHeader* header = mem;
+    if (memcmp(header, &layout, offsetof(FluidShmHeader, latest)) != 0) {
+        munmap(mem, size);
+        close(fd);
+        return NULL;
+    }
+
+    FluidSubscriber* subscriber = ArenaPushStruct(arena, FluidSubscriber);
+    subscriber->fd = fd;
+    subscriber->size = size;
+    subscriber->header = header;
+    return subscriber;
+}
+
+void FluidSubscriberClose(FluidSubscriber* subscriber) {
+    munmap(subscriber->header, subscriber->size);
+    close(subscriber->fd);
+}
+
+// Point view at the newest frame to read in place. False if there is none yet
+// or the publisher has lapped the ring and is rewriting it
+b32 FluidSubscriberBegin(FluidSubscriber* subscriber, FluidShmView* view) {
+    FluidShmHeader* header = subscriber->header;
+    u64 latest = atomic_load_explicit(&header->latest, memory_order_acquire);
+    if (latest == 0) { return false; }
+
+    FluidShmFrame* frame = ShmFrame(header, latest);
+    u8* base = (u8*)frame;
+    view->slot = frame;
+    view->seq = atomic_load_explicit(&frame->seq, memory_order_acquire);
+    if (view->seq & 1) { return false; }
+
+    view->frame = frame->frame;
+    view->dens = (f32*)(base + header->dens_offset);
+    view->u = (f32*)(base + header->u_offset);
+    view->v = (f32*)(base + header->v_offset);
+    view->solid = base + header->solid_offset;
+    return true;
+}
+
+// True if nothing was written to the frame since FluidSubscriberBegin, so
+// whatever was read from the view in between is consistent
+b32 FluidSubscriberEnd(FluidShmView* view) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&view->slot->seq, memory_order_relaxed) == view->seq;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdatomic.h>
+
+#include "core.h"
+#include "fluid.h"
+
+// Shared memory export of simulation frames for other local processes.
+// The object holds a FluidShmHeader followed by FLUID_SHM_FRAMES slots used as
+// a ring, each frame_bytes long. A slot starts with a FluidShmFrame followed by
+// the dens, u and v fields (f32) and the solid field (u8), found at the byte
+// offsets given in the header. Each slot is guarded by a seqlock: seq is odd
+// while the publisher writes the slot, so a reader takes seq, reads the fields
+// in place and accepts them only if seq is even and unchanged afterwards. The
+// publisher never waits on readers.
+#define FLUID_SHM_MAGIC 0x44554c46 // "FLUD"
+#define FLUID_SHM_VERSION 1
+#define FLUID_SHM_FRAMES 4
+#define FLUID_SHM_DEFAULT_NAME "/fluid-simulation"
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 size_buffered;
+    u32 frame_count;
+    u64 frames_offset;
+    u64 frame_bytes;
+    u64 dens_offset;
+    u64 u_offset;
+    u64 v_offset;
+    u64 solid_offset;
+    _Atomic u64 latest; // Frame number of newest complete frame, 0 if none
+} FluidShmHeader;
+
+typedef struct {
+    _Atomic u64 seq;
+    u64 frame;
+} FluidShmFrame;
+
+// Fields of one frame as mapped into the reader, only valid to use once
+// FluidSubscriberEnd has confirmed they were not being written meanwhile
+typedef struct {
+    u64 frame;
+    f32* dens;
+    f32* u;
+    f32* v;
+    u8* solid;
+    FluidShmFrame* slot;
+    u64 seq;
+} FluidShmView;
+
+typedef struct {
+    int fd;
+    u64 size;
+    u64 frame;
+    FluidShmHeader* header;
+    char name[64];
+} FluidPublisher;
+
+typedef struct {
+    int fd;
+    u64 size;
+    FluidShmHeader* header;
+} FluidSubscriber;
+
+// NOTE: Only POSIX platforms are supported, elsewhere these return NULL.
+// Publishing also fails for names of 64 characters or more
+FluidPublisher* FluidPublisherCreate(Arena* arena, const char* name);
+void FluidPublisherDestroy(FluidPublisher* publisher);
+void FluidPublisherWrite(FluidPublisher* publisher, FluidGrid* fluid);
+
+FluidSubscriber* FluidSubscriberOpen(Arena* arena, const char* name);
+void FluidSubscriberClose(FluidSubscriber* subscriber);
+b32 FluidSubscriberBegin(FluidSubscriber* subscriber, FluidShmView* view);
+b32 FluidSubscriberEnd(FluidShmView* view);
+
+#endif // PUBLISH_H
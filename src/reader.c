@@ -0,0 +1,52 @@
+// Example consumer of the frames exported by `game --publish [name]`.
+// Reads the newest frame in place a few times a second and prints a summary.
+// Usage: reader [name]
+#include <time.h>
+
+#include "core.h"
+#include "fluid.h"
+#include "publish.h"
+
+int main(int argc, char** argv) {
+    const char* name = (argc > 1) ? argv[1] : FLUID_SHM_DEFAULT_NAME;
+
+    Arena* arena = ArenaCreate(MiB(1), KiB(64));
+    FluidSubscriber* subscriber = FluidSubscriberOpen(arena, name);
+    if (!subscriber) {
+        printf("[ FAILED ] Unable to open shared memory %s\n", name);
+        return 1;
+    }
+
+    u64 last_frame = 0;
+    for (;;) {
+        FluidShmView view;
+
+        if (FluidSubscriberBegin(subscriber, &view)) {
+            f32 total_density = 0.0f;
+            f32 max_speed = 0.0f;
+            u32 solid_count = 0;
+            for (u32 i = 0; i < FLUID_CELLS_BUFFERED; i++) {
+                total_density += view.dens[i];
+                max_speed = Max(max_speed, sqrt_f32(view.u[i] * view.u[i] + view.v[i] * view.v[i]));
+                solid_count += view.solid[i];
+            }
+
+            // Frame changed underneath us, try again straight away
+            if (!FluidSubscriberEnd(&view)) { continue; }
+
+            if (view.frame != last_frame) {
+                printf("frame %8llu  density %10.3f  max speed %8.3f  solid %5u\n",
+                    (unsigned long long)view.frame, total_density, max_speed, solid_count);
+                last_frame = view.frame;
+                fflush(stdout);
+            }
+        }
+
+        struct timespec ts = { 0, 100 * 1000 * 1000 };
+        nanosleep(&ts, NULL);
+    }
+
+    FluidSubscriberClose(subscriber);
+    ArenaDestroy(arena);
+    return 0;
+}